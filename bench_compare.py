@@ -0,0 +1,59 @@
+"""Compare two StationBench JSON runs and flag regressions.
+
+    python bench_compare.py base.json new.json [--threshold 10] [--noise 2]
+
+A case regresses when its median ns/op grows by more than --threshold
+percent and by more than --noise ns (tiny cases jitter by whole
+nanoseconds), or when it allocates more per op than before. Exits 1 on
+any regression, so it can gate a build.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data, {b["name"]: b for b in data["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent")
+    parser.add_argument("--noise", type=float, default=2.0, help="ignore changes smaller than this many ns")
+    args = parser.parse_args()
+
+    base_run, base = load(args.base)
+    new_run, new = load(args.new)
+    for key in ("config", "renderer"):
+        if base_run.get(key) != new_run.get(key):
+            print("note: %s differs (%s vs %s)" % (key, base_run.get(key), new_run.get(key)))
+
+    regressions = 0
+    print("%-30s %12s %12s %9s %10s  %s" % ("case", "base ns", "new ns", "change", "allocs/op", ""))
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-30s %s" % (name, "only in new" if name in new else "only in base"))
+            continue
+        b, n = base[name], new[name]
+        change = (n["ns_per_op"] - b["ns_per_op"]) / b["ns_per_op"] * 100.0 if b["ns_per_op"] > 0 else 0.0
+        flags = []
+        if change > args.threshold and n["ns_per_op"] - b["ns_per_op"] > args.noise:
+            flags.append("SLOWER")
+        elif change < -args.threshold and b["ns_per_op"] - n["ns_per_op"] > args.noise:
+            flags.append("faster")
+        if n["allocs_per_op"] > b["allocs_per_op"] + 1e-6:
+            flags.append("MORE ALLOCS")
+        if "SLOWER" in flags or "MORE ALLOCS" in flags:
+            regressions += 1
+        print("%-30s %12.3f %12.3f %+8.1f%% %10.4f  %s" % (name, b["ns_per_op"], n["ns_per_op"], change,
+                                                           n["allocs_per_op"], " ".join(flags)))
+    print("%d regression(s)" % regressions)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())